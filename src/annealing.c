@@ -2,6 +2,7 @@
 
 #include "annealing.h"
 #include "rng.h"
+#include "trace.h"
 #include <math.h>
 #include <stddef.h>
 
@@ -9,14 +10,38 @@
 
 // \f$K_{max}\f$ controls the annealing schedule. Higher \f$K_{max}\f$, slower
 // anneal.
-#define ANNEALING_STEP_MAX 999999
+const annealing_schedule default_annealing_schedule = {
+    .step_max = 999999,
+    .initial_temperature = 1.0,
+    .cooling_law = COOLING_LAW_POLYNOMIAL,
+    .cooling_rate = 1.0};
 
 extern void fill_puzzle_regions(annealing_state *puzzle_state);
 
+static const annealing_schedule *annealing_schedule_of(
+    const annealing_state *state) {
+  return state->schedule ? state->schedule : &default_annealing_schedule;
+}
+
+static uint32_t free_cells_in_region(const annealing_state *state,
+                                     uint32_t region) {
+  uint32_t free_cells = 0;
+  for (size_t row = 0; row < 3; row++) {
+    for (size_t column = 0; column < 3; column++) {
+      free_cells += !state->given_puzzle_positions
+                         ->data[((region / 3) * 3) + row]
+                               [((region % 3) * 3) + column];
+    }
+  }
+  return free_cells;
+}
+
 static void select_neighbouring_state(annealing_state *state,
                                       carr2_u8 *new_state) {
   const uint32_t region =
-      random_uint32_t(state->random_number_generator_state) % 9;
+      state->swappable_regions[random_uint32_t(
+                                   state->random_number_generator_state) %
+                               state->swappable_region_count];
 
   uint32_t some_cell_row =
       random_uint32_t(state->random_number_generator_state) % 3;
@@ -58,34 +83,25 @@ static void select_neighbouring_state(annealing_state *state,
       some_cell_value;
 }
 
+// The cost of a state is the number of repeated numbers in its rows and
+// columns. Numbers seen so far are tracked as bitmasks, bit \f$n\f$ set meaning
+// the number \f$n\f$ was already found, as this runs on every annealing step.
 uint32_t cost(uint8_t **state) {
   uint32_t cost = 0;
   for (size_t i = 0; i < 9; i++) {
-    clist_u8 found_row_nums = clist_u8_init();
-    clist_u8 found_col_nums = clist_u8_init();
+    uint16_t found_row_nums = 0;
+    uint16_t found_col_nums = 0;
 
     for (size_t j = 0; j < 9; j++) {
-      clist_u8_iter found_row_nums_iter =
-          clist_u8_find(&found_row_nums, state[i][j]);
-      clist_u8_iter found_row_nums_end_iter = clist_u8_end(&found_row_nums);
-      if (found_row_nums_iter.ref == found_row_nums_end_iter.ref) {
-        clist_u8_push_back(&found_row_nums, state[i][j]);
-      } else {
-        cost++;
-      }
-
-      clist_u8_iter found_col_nums_iter =
-          clist_u8_find(&found_col_nums, state[j][i]);
-      clist_u8_iter found_col_nums_end_iter = clist_u8_end(&found_col_nums);
-      if (found_col_nums_iter.ref == found_col_nums_end_iter.ref) {
-        clist_u8_push_back(&found_col_nums, state[j][i]);
-      } else {
-        cost++;
-      }
-    }
+      const uint16_t row_num = 1 << state[i][j];
+      const uint16_t col_num = 1 << state[j][i];
+
+      cost += ((found_row_nums & row_num) != 0);
+      cost += ((found_col_nums & col_num) != 0);
 
-    clist_u8_drop(&found_col_nums);
-    clist_u8_drop(&found_row_nums);
+      found_row_nums |= row_num;
+      found_col_nums |= col_num;
+    }
   }
   return cost;
 }
@@ -97,13 +113,53 @@ static void reheat(annealing_state *state) {
   carr2_u8_copy(state->sudoku_puzzle_state, *(state->initial_puzzle_state));
   fill_puzzle_regions(state);
   state->sudoku_puzzle_state_cost = cost(state->sudoku_puzzle_state->data);
-  state->temperature = 1.0;
+  state->temperature = annealing_schedule_of(state)->initial_temperature;
+}
+
+// Start annealing from a random initial configuration. Two numbers can only be
+// swapped in a region with at least two cells that weren't given, and as the
+// given positions never change those regions are found once here. A puzzle
+// whose regions each have at most one cell left to fill is solved by filling
+// the regions, so there is nothing to anneal.
+void initialize_annealing_state(annealing_state *state) {
+  state->swappable_region_count = 0;
+  for (uint32_t region = 0; region < 9; region++) {
+    if (free_cells_in_region(state, region) >= 2) {
+      state->swappable_regions[state->swappable_region_count++] = region;
+    }
+  }
+
+  TRACE_ANNEALING_RUN(state);
+  reheat(state);
+  state->annealing = (state->sudoku_puzzle_state_cost != 0 &&
+                      state->swappable_region_count != 0);
+}
+
+static double cooled_temperature(const annealing_schedule *schedule,
+                                 uint64_t number_of_state_changes) {
+  const double fraction_of_schedule =
+      (double)(number_of_state_changes + 1) / (double)schedule->step_max;
+
+  switch (schedule->cooling_law) {
+    case COOLING_LAW_EXPONENTIAL:
+      return schedule->initial_temperature *
+             exp(-schedule->cooling_rate * fraction_of_schedule);
+    case COOLING_LAW_POLYNOMIAL:
+      break;
+  }
+
+  return schedule->initial_temperature *
+         pow(1.0 - fraction_of_schedule, schedule->cooling_rate);
 }
 
 void update_annealing_state(annealing_state *state) {
+  const annealing_schedule *schedule = annealing_schedule_of(state);
+
   // If we reach \f$K_{max}\f$, we'll try reheating instead of terminating,
   // allowing a fast annealing schedule to be used.
-  if (state->number_of_state_changes >= ANNEALING_STEP_MAX - 1) {
+  const bool reheating =
+      state->number_of_state_changes >= schedule->step_max - 1;
+  if (reheating) {
     reheat(state);
   }
 
@@ -127,19 +183,23 @@ void update_annealing_state(annealing_state *state) {
       exp((-1.0 * cost_difference) / state->temperature);
 
   // If \f$P(cost(s),cost(s_{new}), T) \geq random(0,1)\f$
-  if (acceptance_probability >= random_number_range_zero_to_one ||
-      cost_of_new_state == 0) {
+  const bool accepted =
+      acceptance_probability >= random_number_range_zero_to_one ||
+      cost_of_new_state == 0;
+  if (accepted) {
     // \f$s \leftarrow s_{new}\f$
     memcpy(carr2_u8_data(state->sudoku_puzzle_state), carr2_u8_data(&new_state),
            carr2_u8_size(*state->sudoku_puzzle_state));
     state->sudoku_puzzle_state_cost = cost_of_new_state;
   }
 
-  state->temperature = 1.0 - ((double)(state->number_of_state_changes + 1) /
-                              (double)ANNEALING_STEP_MAX);
+  state->temperature =
+      cooled_temperature(schedule, state->number_of_state_changes);
 
   carr2_u8_drop(&new_state);
 
+  TRACE_ANNEALING_STEP(state, accepted, reheating);
+
   if (cost_of_new_state == 0) {
     state->annealing = false;
   }
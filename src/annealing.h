@@ -5,6 +5,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include "config.h"
+
 #define i_val uint_fast8_t
 #define i_tag u8
 #include <stc/carr2.h>
@@ -13,6 +15,25 @@
 #define i_tag u8
 #include <stc/clist.h>
 
+enum cooling_law {
+  COOLING_LAW_POLYNOMIAL,
+  COOLING_LAW_EXPONENTIAL,
+};
+
+// With \f$f = (k+1)/k_{max}\f$, polynomial cooling is
+// \f$T = T_0(1-f)^{rate}\f$ and exponential cooling is
+// \f$T = T_0e^{-rate \cdot f}\f$.
+struct annealing_schedule {
+  uint64_t step_max;
+  double initial_temperature;
+  enum cooling_law cooling_law;
+  double cooling_rate;
+};
+
+typedef struct annealing_schedule annealing_schedule;
+
+extern const annealing_schedule default_annealing_schedule;
+
 struct annealing_state {
   uint32_t random_number_generator_state[4];
   double temperature;
@@ -21,11 +42,21 @@ struct annealing_state {
   carr2_u8 *sudoku_puzzle_state;
   carr2_u8 *given_puzzle_positions;
   uint32_t sudoku_puzzle_state_cost;
+  // The default schedule is used when no schedule is given.
+  const annealing_schedule *schedule;
+  // Regions with at least two free cells, filled in by
+  // initialize_annealing_state.
+  uint8_t swappable_regions[9];
+  uint8_t swappable_region_count;
   bool annealing;
+#ifdef ANNEALING_TRACE
+  struct trace_buffer *trace;
+#endif
 };
 
 typedef struct annealing_state annealing_state;
 
+void initialize_annealing_state(annealing_state *state);
 void update_annealing_state(annealing_state *state);
 
 uint32_t cost(uint_fast8_t **state);
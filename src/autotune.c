@@ -0,0 +1,485 @@
+// SPDX-License-Identifier: ISC
+
+// Tunes the annealing schedule against a corpus of puzzles, one puzzle per
+// line, writing a schedule profile with a schedule for each difficulty bucket.
+//
+// Candidate schedules are drawn at random, with the default schedule always
+// among them, and narrowed down by successive halving: every round the
+// surviving schedules solve twice as many puzzles as the round before and the
+// worse half is discarded. Every schedule solves a puzzle from the same seeds,
+// so the comparison between schedules is not left to luck, and the whole
+// search repeats exactly for the same corpus and search seed.
+//
+// Time to solution is measured in annealing steps, which costs the same for
+// every schedule, rather than in wall time, which depends on what else the
+// machine is running. A run that is not solved within the step budget counts
+// as taking the whole budget.
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "annealing.h"
+#include "puzzle.h"
+#include "rng.h"
+#include "schedule.h"
+
+enum tuning_objective {
+  TUNING_OBJECTIVE_MEAN,
+  TUNING_OBJECTIVE_P99,
+};
+
+struct autotuner {
+  enum tuning_objective objective;
+  uint32_t configuration_count;
+  uint32_t seeds_per_puzzle;
+  uint64_t step_budget;
+  uint64_t search_seed;
+  long thread_count;
+  carr2_u8 *puzzles;
+  size_t puzzle_count;
+};
+
+// The runs of one difficulty bucket. Run \f$r\f$ solves puzzle
+// \f$r \bmod n\f$ of the bucket's \f$n\f$ puzzles, so the first rounds see as
+// many different puzzles as possible.
+struct tuning_bucket {
+  size_t *puzzle_indices;
+  size_t puzzle_count;
+  size_t run_count;
+  annealing_schedule *configurations;
+  uint64_t *steps_to_solution;
+};
+
+struct tuning_task {
+  size_t configuration;
+  size_t run;
+};
+
+struct tuning_round {
+  struct autotuner *autotuner;
+  struct tuning_bucket *bucket;
+  struct tuning_task *tasks;
+  size_t task_count;
+  atomic_size_t next_task;
+};
+
+static double random_unit_interval(uint32_t *random_number_generator_state) {
+  return (double)random_uint32_t(random_number_generator_state) /
+         (double)UINT32_MAX;
+}
+
+static double random_log_uniform(uint32_t *random_number_generator_state,
+                                 double low,
+                                 double high) {
+  return exp(log(low) + (log(high / low) *
+                         random_unit_interval(random_number_generator_state)));
+}
+
+static annealing_schedule random_annealing_schedule(
+    uint32_t *random_number_generator_state) {
+  annealing_schedule schedule = {
+      .step_max =
+          random_log_uniform(random_number_generator_state, 1.0e4, 1.0e7),
+      .initial_temperature =
+          random_log_uniform(random_number_generator_state, 0.05, 5.0),
+      .cooling_law = (random_uint32_t(random_number_generator_state) & 1)
+                         ? COOLING_LAW_EXPONENTIAL
+                         : COOLING_LAW_POLYNOMIAL,
+      .cooling_rate = 1.0};
+
+  schedule.cooling_rate =
+      (schedule.cooling_law == COOLING_LAW_EXPONENTIAL)
+          ? 1.0 + (9.0 * random_unit_interval(random_number_generator_state))
+          : 0.5 + (3.5 * random_unit_interval(random_number_generator_state));
+
+  return schedule;
+}
+
+// Count the annealing steps a schedule takes to solve a puzzle, starting from
+// a seed that depends only on the puzzle and the run.
+static uint64_t steps_to_solution(struct autotuner *autotuner,
+                                  const annealing_schedule *schedule,
+                                  size_t puzzle_index,
+                                  size_t seed_index) {
+  carr2_u8 given_puzzle_positions = carr2_u8_init(9, 9);
+  carr2_u8 initial_puzzle_positions = carr2_u8_init(9, 9);
+  carr2_u8 n_by_n = carr2_u8_init(9, 9);
+
+  carr2_u8_copy(&initial_puzzle_positions, autotuner->puzzles[puzzle_index]);
+  for (size_t i = 0; i < 9; i++) {
+    for (size_t j = 0; j < 9; j++) {
+      given_puzzle_positions.data[i][j] =
+          (initial_puzzle_positions.data[i][j] != 0);
+    }
+  }
+
+  annealing_state state = {
+      .annealing = true,
+      .temperature = schedule->initial_temperature,
+      .schedule = schedule,
+      .initial_puzzle_state = &initial_puzzle_positions,
+      .sudoku_puzzle_state = &n_by_n,
+      .given_puzzle_positions = &given_puzzle_positions,
+      .number_of_state_changes = 0,
+      .sudoku_puzzle_state_cost = 9999,
+      .random_number_generator_state = {0}};
+
+  seed_random_number_generator(
+      state.random_number_generator_state,
+      autotuner->search_seed ^ (puzzle_index * 0x100000001b3) ^
+          ((uint64_t)seed_index << 48));
+
+  initialize_annealing_state(&state);
+
+  uint64_t steps = 0;
+  while (state.annealing && steps < autotuner->step_budget) {
+    update_annealing_state(&state);
+    steps++;
+  }
+
+  carr2_u8_drop(&n_by_n);
+  carr2_u8_drop(&initial_puzzle_positions);
+  carr2_u8_drop(&given_puzzle_positions);
+
+  return steps;
+}
+
+static void *run_tuning_tasks(void *argument) {
+  struct tuning_round *round = argument;
+  struct tuning_bucket *bucket = round->bucket;
+
+  size_t task_index;
+  while ((task_index = atomic_fetch_add(&round->next_task, 1)) <
+         round->task_count) {
+    const struct tuning_task *task = &round->tasks[task_index];
+    const size_t puzzle_index =
+        bucket->puzzle_indices[task->run % bucket->puzzle_count];
+    const size_t seed_index = task->run / bucket->puzzle_count;
+
+    bucket->steps_to_solution[(task->configuration * bucket->run_count) +
+                              task->run] =
+        steps_to_solution(round->autotuner,
+                          &bucket->configurations[task->configuration],
+                          puzzle_index, seed_index);
+  }
+
+  return NULL;
+}
+
+// Make sure each of the surviving configurations has completed the first
+// \f$run_count\f$ runs, sharing the runs that haven't been made yet between
+// threads. Runs from earlier rounds are kept.
+static void complete_tuning_runs(struct autotuner *autotuner,
+                                 struct tuning_bucket *bucket,
+                                 const size_t *survivors,
+                                 size_t survivor_count,
+                                 size_t run_count) {
+  struct tuning_round round = {.autotuner = autotuner,
+                               .bucket = bucket,
+                               .tasks = calloc(survivor_count * run_count,
+                                               sizeof(struct tuning_task)),
+                               .task_count = 0,
+                               .next_task = 0};
+  pthread_t *threads = calloc(autotuner->thread_count, sizeof(pthread_t));
+  if (!round.tasks || !threads) {
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t run = 0; run < run_count; run++) {
+    for (size_t i = 0; i < survivor_count; i++) {
+      if (bucket->steps_to_solution[(survivors[i] * bucket->run_count) + run] ==
+          UINT64_MAX) {
+        round.tasks[round.task_count++] =
+            (struct tuning_task){.configuration = survivors[i], .run = run};
+      }
+    }
+  }
+
+  for (long i = 0; i < autotuner->thread_count; i++) {
+    if (pthread_create(&threads[i], NULL, run_tuning_tasks, &round)) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (long i = 0; i < autotuner->thread_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  free(round.tasks);
+}
+
+static int compare_steps(const void *a, const void *b) {
+  const uint64_t steps_a = *(const uint64_t *)a;
+  const uint64_t steps_b = *(const uint64_t *)b;
+  return (steps_a > steps_b) - (steps_a < steps_b);
+}
+
+static double tuning_score(struct autotuner *autotuner,
+                           struct tuning_bucket *bucket,
+                           size_t configuration,
+                           size_t run_count) {
+  const uint64_t *steps =
+      &bucket->steps_to_solution[configuration * bucket->run_count];
+
+  if (autotuner->objective == TUNING_OBJECTIVE_MEAN) {
+    double total_steps = 0.0;
+    for (size_t run = 0; run < run_count; run++) {
+      total_steps += steps[run];
+    }
+    return total_steps / run_count;
+  }
+
+  uint64_t *sorted_steps = malloc(run_count * sizeof(uint64_t));
+  if (!sorted_steps) {
+    exit(EXIT_FAILURE);
+  }
+  memcpy(sorted_steps, steps, run_count * sizeof(uint64_t));
+  qsort(sorted_steps, run_count, sizeof(uint64_t), compare_steps);
+
+  const double p99_steps =
+      sorted_steps[(size_t)ceil(0.99 * run_count) - 1];
+  free(sorted_steps);
+
+  return p99_steps;
+}
+
+// Sort survivors from best to worst score. A plain insertion sort, as there
+// are only as many survivors as candidate schedules.
+static void rank_survivors(struct autotuner *autotuner,
+                           struct tuning_bucket *bucket,
+                           size_t *survivors,
+                           double *scores,
+                           size_t survivor_count,
+                           size_t run_count) {
+  for (size_t i = 0; i < survivor_count; i++) {
+    scores[i] = tuning_score(autotuner, bucket, survivors[i], run_count);
+  }
+
+  for (size_t i = 1; i < survivor_count; i++) {
+    const size_t survivor = survivors[i];
+    const double score = scores[i];
+    size_t j = i;
+    while (j > 0 && scores[j - 1] > score) {
+      survivors[j] = survivors[j - 1];
+      scores[j] = scores[j - 1];
+      j--;
+    }
+    survivors[j] = survivor;
+    scores[j] = score;
+  }
+}
+
+static annealing_schedule tune_bucket(struct autotuner *autotuner,
+                                      size_t bucket_index) {
+  struct tuning_bucket bucket = {0};
+  uint32_t random_number_generator_state[4];
+  seed_random_number_generator(random_number_generator_state,
+                               autotuner->search_seed + bucket_index);
+
+  bucket.puzzle_indices = calloc(autotuner->puzzle_count, sizeof(size_t));
+  if (!bucket.puzzle_indices) {
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < autotuner->puzzle_count; i++) {
+    if (difficulty_bucket_of(count_puzzle_clues(&autotuner->puzzles[i])) ==
+        bucket_index) {
+      bucket.puzzle_indices[bucket.puzzle_count++] = i;
+    }
+  }
+
+  if (bucket.puzzle_count == 0) {
+    fprintf(stderr, "%s: no puzzles, keeping the default schedule\n",
+            difficulty_buckets[bucket_index].name);
+    free(bucket.puzzle_indices);
+    return default_annealing_schedule;
+  }
+
+  // Shuffle the bucket's puzzles, so that the first rounds aren't decided by
+  // however the corpus happens to be ordered.
+  for (size_t i = bucket.puzzle_count - 1; i > 0; i--) {
+    const size_t j = random_uint32_t(random_number_generator_state) % (i + 1);
+    const size_t puzzle_index = bucket.puzzle_indices[i];
+    bucket.puzzle_indices[i] = bucket.puzzle_indices[j];
+    bucket.puzzle_indices[j] = puzzle_index;
+  }
+
+  const size_t configuration_count = autotuner->configuration_count;
+  bucket.run_count = bucket.puzzle_count * autotuner->seeds_per_puzzle;
+  bucket.configurations =
+      calloc(configuration_count, sizeof(annealing_schedule));
+  bucket.steps_to_solution =
+      malloc(configuration_count * bucket.run_count * sizeof(uint64_t));
+  size_t *survivors = calloc(configuration_count, sizeof(size_t));
+  double *scores = calloc(configuration_count, sizeof(double));
+  if (!bucket.configurations || !bucket.steps_to_solution || !survivors ||
+      !scores) {
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < configuration_count * bucket.run_count; i++) {
+    bucket.steps_to_solution[i] = UINT64_MAX;
+  }
+
+  bucket.configurations[0] = default_annealing_schedule;
+  survivors[0] = 0;
+  for (size_t i = 1; i < configuration_count; i++) {
+    bucket.configurations[i] =
+        random_annealing_schedule(random_number_generator_state);
+    survivors[i] = i;
+  }
+
+  size_t survivor_count = configuration_count;
+  for (;;) {
+    // Each round makes half as many runs as the next, so that the last round,
+    // with a single survivor left, makes every run.
+    size_t rounds_left = 0;
+    while (((size_t)1 << rounds_left) < survivor_count) {
+      rounds_left++;
+    }
+    const size_t run_count =
+        (bucket.run_count + ((size_t)1 << rounds_left) - 1) >> rounds_left;
+
+    complete_tuning_runs(autotuner, &bucket, survivors, survivor_count,
+                         run_count);
+    rank_survivors(autotuner, &bucket, survivors, scores, survivor_count,
+                   run_count);
+
+    fprintf(stderr, "%s: %zu schedules over %zu runs, best %.0f steps\n",
+            difficulty_buckets[bucket_index].name, survivor_count, run_count,
+            scores[0]);
+
+    if (survivor_count == 1) {
+      break;
+    }
+
+    survivor_count = (survivor_count + 1) / 2;
+  }
+
+  // The default schedule may have been discarded on few runs, so it is
+  // compared with the winner over every run and kept unless it loses.
+  const size_t default_configuration = 0;
+  complete_tuning_runs(autotuner, &bucket, &default_configuration, 1,
+                       bucket.run_count);
+  const double default_score = tuning_score(
+      autotuner, &bucket, default_configuration, bucket.run_count);
+  const annealing_schedule tuned_schedule =
+      (scores[0] < default_score) ? bucket.configurations[survivors[0]]
+                                  : default_annealing_schedule;
+
+  fprintf(stderr, "%s: %zu puzzles, default %.0f steps, tuned %.0f steps\n",
+          difficulty_buckets[bucket_index].name, bucket.puzzle_count,
+          default_score,
+          (scores[0] < default_score) ? scores[0] : default_score);
+
+  free(scores);
+  free(survivors);
+  free(bucket.steps_to_solution);
+  free(bucket.configurations);
+  free(bucket.puzzle_indices);
+
+  return tuned_schedule;
+}
+
+static bool load_puzzle_corpus(const char *path, struct autotuner *autotuner) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+
+  const bool loaded = read_puzzle_list(file, path, &autotuner->puzzles,
+                                       &autotuner->puzzle_count);
+  fclose(file);
+
+  return loaded && autotuner->puzzle_count > 0;
+}
+
+static void print_usage(void) {
+  printf(
+      "Usage: sudoku-autotune [-o mean|p99] [-n schedules] [-s seeds] "
+      "[-b step budget] [-j threads] [-r search seed] <corpus>\n");
+}
+
+int main(int argc, char **argv) {
+  struct autotuner autotuner = {
+      .objective = TUNING_OBJECTIVE_MEAN,
+      .configuration_count = 32,
+      .seeds_per_puzzle = 2,
+      .step_budget = 10000000,
+      .search_seed = 1,
+      .thread_count = sysconf(_SC_NPROCESSORS_ONLN),
+      .puzzles = NULL,
+      .puzzle_count = 0};
+
+  int option;
+  while ((option = getopt(argc, argv, "o:n:s:b:j:r:")) != -1) {
+    switch (option) {
+      case 'o':
+        if (strcmp(optarg, "mean") == 0) {
+          autotuner.objective = TUNING_OBJECTIVE_MEAN;
+        } else if (strcmp(optarg, "p99") == 0) {
+          autotuner.objective = TUNING_OBJECTIVE_P99;
+        } else {
+          print_usage();
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'n':
+        autotuner.configuration_count = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        autotuner.seeds_per_puzzle = strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        autotuner.step_budget = strtoull(optarg, NULL, 10);
+        break;
+      case 'j':
+        autotuner.thread_count = strtol(optarg, NULL, 10);
+        break;
+      case 'r':
+        autotuner.search_seed = strtoull(optarg, NULL, 10);
+        break;
+      default:
+        print_usage();
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1 || autotuner.configuration_count < 1 ||
+      autotuner.seeds_per_puzzle < 1 || autotuner.step_budget < 1) {
+    print_usage();
+    return EXIT_FAILURE;
+  }
+
+  if (autotuner.thread_count < 1) {
+    autotuner.thread_count = 1;
+  }
+
+  if (!load_puzzle_corpus(argv[optind], &autotuner)) {
+    return EXIT_FAILURE;
+  }
+
+  schedule_profile profile;
+  for (size_t bucket = 0; bucket < DIFFICULTY_BUCKET_COUNT; bucket++) {
+    profile.schedules[bucket] = tune_bucket(&autotuner, bucket);
+  }
+
+  write_schedule_profile(stdout, &profile);
+
+  for (size_t i = 0; i < autotuner.puzzle_count; i++) {
+    carr2_u8_drop(&autotuner.puzzles[i]);
+  }
+  free(autotuner.puzzles);
+
+  return EXIT_SUCCESS;
+}
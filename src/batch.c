@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: ISC
+
+// Solves a batch of puzzles read from stdin, one puzzle per line, writing the
+// solutions to stdout in the order the puzzles were read.
+//
+// The time to solve a batch is set by its slowest puzzles, so puzzles are
+// started longest expected first, leaving the short ones to fill in around
+// them. Once every puzzle has been started, threads that run out of work join
+// the puzzles still being solved as extra annealing chains, each from its own
+// random seed. The first chain to find a solution stops the others.
+
+#include "batch.h"
+#include "sys/random.h"
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "annealing.h"
+#include "config.h"
+#include "puzzle.h"
+#include "timing.h"
+#include "trace.h"
+
+// A cheap estimate of how long annealing a puzzle will take, made when the
+// puzzle is read. After filling in the cells constraint propagation can, each
+// region with \f$n\f$ free cells can be filled in \f$n!\f$ ways, and the
+// search space is the natural logarithm of the product over all regions.
+struct difficulty_estimate {
+  uint32_t clues;
+  double search_space;
+};
+
+struct batch_puzzle {
+  carr2_u8 puzzle;
+  carr2_u8 solution;
+  struct difficulty_estimate estimate;
+  const annealing_schedule *schedule;
+  atomic_bool solved;
+  atomic_uint chains;
+};
+
+struct batch {
+  struct batch_puzzle *puzzles;
+  size_t puzzle_count;
+  size_t *longest_expected_first;
+  atomic_size_t next_puzzle;
+  struct timespec start;
+};
+
+// Fills in the cells constraint propagation can, so that the puzzle is
+// annealed from the same search space it is estimated from.
+static struct difficulty_estimate estimate_difficulty(carr2_u8 *puzzle) {
+  struct difficulty_estimate estimate = {
+      .clues = count_puzzle_clues(puzzle), .search_space = 0.0};
+
+  propagate_constraints(puzzle);
+
+  for (size_t region = 0; region < 9; region++) {
+    uint32_t free_cells = 0;
+    for (size_t row = 0; row < 3; row++) {
+      for (size_t column = 0; column < 3; column++) {
+        free_cells += !puzzle->data[((region / 3) * 3) + row]
+                             [((region % 3) * 3) + column];
+      }
+    }
+
+    estimate.search_space += lgamma(free_cells + 1.0);
+  }
+
+  return estimate;
+}
+
+struct expected_duration {
+  size_t puzzle;
+  struct difficulty_estimate estimate;
+};
+
+// Larger search spaces first. Of equal search spaces, the puzzle with fewer
+// clues goes first.
+static int compare_expected_durations(const void *a, const void *b) {
+  const struct difficulty_estimate *estimate_a =
+      &((const struct expected_duration *)a)->estimate;
+  const struct difficulty_estimate *estimate_b =
+      &((const struct expected_duration *)b)->estimate;
+
+  if (estimate_a->search_space != estimate_b->search_space) {
+    return (estimate_a->search_space < estimate_b->search_space) ? 1 : -1;
+  }
+  return (estimate_a->clues > estimate_b->clues) -
+         (estimate_a->clues < estimate_b->clues);
+}
+
+// Once every puzzle has been started, help whichever unsolved puzzle has the
+// fewest chains, preferring the longest expected. Returns NULL when every
+// puzzle is solved.
+static struct batch_puzzle *next_batch_puzzle(struct batch *batch) {
+  const size_t next = atomic_fetch_add(&batch->next_puzzle, 1);
+  if (next < batch->puzzle_count) {
+    return &batch->puzzles[batch->longest_expected_first[next]];
+  }
+
+  struct batch_puzzle *straggler = NULL;
+  unsigned straggler_chains = UINT32_MAX;
+  for (size_t i = 0; i < batch->puzzle_count; i++) {
+    struct batch_puzzle *puzzle =
+        &batch->puzzles[batch->longest_expected_first[i]];
+    const unsigned chains = atomic_load(&puzzle->chains);
+    if (!atomic_load(&puzzle->solved) && chains < straggler_chains) {
+      straggler = puzzle;
+      straggler_chains = chains;
+    }
+  }
+
+  return straggler;
+}
+
+static void anneal_batch_puzzle(struct batch_puzzle *puzzle) {
+  carr2_u8 given_puzzle_positions = carr2_u8_init(9, 9);
+  carr2_u8 n_by_n = carr2_u8_init(9, 9);
+
+  for (size_t i = 0; i < 9; i++) {
+    for (size_t j = 0; j < 9; j++) {
+      given_puzzle_positions.data[i][j] = (puzzle->puzzle.data[i][j] != 0);
+    }
+  }
+
+  annealing_state state = {
+      .annealing = true,
+      .temperature = puzzle->schedule->initial_temperature,
+      .schedule = puzzle->schedule,
+      .initial_puzzle_state = &puzzle->puzzle,
+      .sudoku_puzzle_state = &n_by_n,
+      .given_puzzle_positions = &given_puzzle_positions,
+      .number_of_state_changes = 0,
+      .sudoku_puzzle_state_cost = 9999,
+      .random_number_generator_state = {0}};
+
+#ifdef ANNEALING_TRACE
+  state.trace = trace_attach();
+#endif
+
+  if (getrandom(state.random_number_generator_state,
+                sizeof(state.random_number_generator_state), 0) < 1) {
+    exit(EXIT_FAILURE);
+  }
+
+  atomic_fetch_add(&puzzle->chains, 1);
+
+  initialize_annealing_state(&state);
+  while (state.annealing &&
+         !atomic_load_explicit(&puzzle->solved, memory_order_relaxed)) {
+    update_annealing_state(&state);
+  }
+
+  // Only the first chain to finish keeps its solution.
+  if (!state.annealing && !atomic_exchange(&puzzle->solved, true)) {
+    carr2_u8_copy(&puzzle->solution, n_by_n);
+  }
+
+  atomic_fetch_sub(&puzzle->chains, 1);
+
+#ifdef ANNEALING_TRACE
+  trace_detach(state.trace);
+#endif
+
+  carr2_u8_drop(&n_by_n);
+  carr2_u8_drop(&given_puzzle_positions);
+}
+
+static void *solve_batch_puzzles(void *argument) {
+  struct batch *batch = argument;
+
+  struct batch_puzzle *puzzle;
+  while ((puzzle = next_batch_puzzle(batch))) {
+    anneal_batch_puzzle(puzzle);
+  }
+
+  return NULL;
+}
+
+static bool read_batch_puzzles(struct batch *batch,
+                               const schedule_profile *profile) {
+  carr2_u8 *puzzles;
+  if (!read_puzzle_list(stdin, "stdin", &puzzles, &batch->puzzle_count)) {
+    return false;
+  }
+
+  batch->puzzles = calloc(batch->puzzle_count, sizeof(struct batch_puzzle));
+  if (!batch->puzzles && batch->puzzle_count) {
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < batch->puzzle_count; i++) {
+    const struct difficulty_estimate estimate =
+        estimate_difficulty(&puzzles[i]);
+    batch->puzzles[i] = (struct batch_puzzle){
+        .puzzle = puzzles[i],
+        .solution = carr2_u8_init(9, 9),
+        .estimate = estimate,
+        .schedule = &profile->schedules[difficulty_bucket_of(estimate.clues)],
+        .solved = false,
+        .chains = 0};
+  }
+
+  free(puzzles);
+
+  return true;
+}
+
+static void write_batch_solutions(struct batch *batch) {
+  for (size_t i = 0; i < batch->puzzle_count; i++) {
+    for (size_t row = 0; row < 9; row++) {
+      for (size_t column = 0; column < 9; column++) {
+        putchar('0' + batch->puzzles[i].solution.data[row][column]);
+      }
+      putchar((row < 8) ? ' ' : '\n');
+    }
+  }
+}
+
+int solve_puzzle_batch(int argc,
+                       char **argv,
+                       const schedule_profile *profile) {
+  if (argc > 1) {
+    printf("Usage: " PROGRAM_NAME " batch [threads] < puzzles\n");
+    return EXIT_FAILURE;
+  }
+
+  struct batch batch = {.puzzles = NULL,
+                        .puzzle_count = 0,
+                        .longest_expected_first = NULL,
+                        .next_puzzle = 0};
+
+  if (!read_batch_puzzles(&batch, profile)) {
+    return EXIT_FAILURE;
+  }
+
+  if (batch.puzzle_count == 0) {
+    return EXIT_SUCCESS;
+  }
+
+  long thread_count = (argc > 0) ? strtol(argv[0], NULL, 10)
+                                 : sysconf(_SC_NPROCESSORS_ONLN);
+  if (thread_count < 1) {
+    thread_count = 1;
+  }
+
+  batch.longest_expected_first = calloc(batch.puzzle_count, sizeof(size_t));
+  struct expected_duration *expected_durations =
+      calloc(batch.puzzle_count, sizeof(struct expected_duration));
+  pthread_t *threads = calloc(thread_count, sizeof(pthread_t));
+  if (!batch.longest_expected_first || !expected_durations || !threads) {
+    return EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < batch.puzzle_count; i++) {
+    expected_durations[i] = (struct expected_duration){
+        .puzzle = i, .estimate = batch.puzzles[i].estimate};
+  }
+  qsort(expected_durations, batch.puzzle_count,
+        sizeof(struct expected_duration), compare_expected_durations);
+  for (size_t i = 0; i < batch.puzzle_count; i++) {
+    batch.longest_expected_first[i] = expected_durations[i].puzzle;
+  }
+  free(expected_durations);
+
+  clock_gettime(CLOCK_MONOTONIC, &batch.start);
+
+  for (long i = 0; i < thread_count; i++) {
+    if (pthread_create(&threads[i], NULL, solve_batch_puzzles, &batch)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (long i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  write_batch_solutions(&batch);
+
+  fprintf(stderr, "%zu puzzles solved in %.2fs on %ld threads\n",
+          batch.puzzle_count, seconds_since(&batch.start), thread_count);
+
+  for (size_t i = 0; i < batch.puzzle_count; i++) {
+    carr2_u8_drop(&batch.puzzles[i].solution);
+    carr2_u8_drop(&batch.puzzles[i].puzzle);
+  }
+  free(threads);
+  free(batch.longest_expected_first);
+  free(batch.puzzles);
+
+  return EXIT_SUCCESS;
+}
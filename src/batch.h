@@ -0,0 +1,7 @@
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include "schedule.h"
+
+int solve_puzzle_batch(int argc, char **argv, const schedule_profile *profile);
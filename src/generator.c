@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: ISC
+
+// Puzzles are generated by annealing an empty grid into a complete solution,
+// then removing clues while the puzzle keeps exactly one solution. Clues are
+// removed a symmetry orbit at a time, so the clues left behind keep the
+// requested symmetry. Every core runs its own generator and puzzles are
+// streamed to stdout as soon as they are found.
+
+#include "generator.h"
+#include "sys/random.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "annealing.h"
+#include "config.h"
+#include "puzzle.h"
+#include "rng.h"
+#include "timing.h"
+#include "trace.h"
+
+// Removing clues from a solution in a different order can reach clue counts
+// that an unlucky order can't, so a solution is given a few chances before a
+// new one is annealed.
+#define GENERATOR_REMOVAL_ATTEMPTS 8
+
+// Generation gives up if this many solutions have been annealed without
+// reaching the target clue count once.
+#define GENERATOR_SOLUTION_LIMIT 256
+
+enum clue_symmetry {
+  CLUE_SYMMETRY_NONE,
+  CLUE_SYMMETRY_ROTATIONAL,
+  CLUE_SYMMETRY_MIRROR,
+};
+
+// Puzzles with as few as 17 clues have a unique solution, but removing clues
+// one orbit at a time stops at the first puzzle from which no orbit can be
+// removed, and that is rarely below these counts. Larger orbits leave more
+// clues behind.
+static const uint32_t minimum_target_clues[] = {
+    [CLUE_SYMMETRY_NONE] = 22,
+    [CLUE_SYMMETRY_ROTATIONAL] = 24,
+    [CLUE_SYMMETRY_MIRROR] = 26,
+};
+
+struct generator {
+  uint32_t target_clues;
+  uint64_t puzzle_count;
+  enum clue_symmetry symmetry;
+  atomic_uint_fast64_t puzzles_claimed;
+  atomic_uint_fast64_t puzzles_generated;
+  atomic_uint_fast64_t solutions_annealed;
+  // Set once every requested puzzle has been claimed, or generation has given
+  // up, so that the other threads stop annealing. The last puzzle is written
+  // \f$seconds\_to\_last\_puzzle\f$ after \f$start\f$.
+  atomic_bool stopping;
+  atomic_bool gave_up;
+  double seconds_to_last_puzzle;
+  struct timespec start;
+  pthread_mutex_t output_lock;
+};
+
+// Fill the cells that are in the same symmetry orbit as \f$cell\f$, returning
+// the size of the orbit.
+static size_t clue_symmetry_orbit(enum clue_symmetry symmetry,
+                                  size_t cell,
+                                  size_t orbit[4]) {
+  const size_t row = cell / 9;
+  const size_t column = cell % 9;
+  size_t candidates[4] = {cell, cell, cell, cell};
+
+  switch (symmetry) {
+    case CLUE_SYMMETRY_NONE:
+      break;
+    case CLUE_SYMMETRY_ROTATIONAL:
+      candidates[1] = ((8 - row) * 9) + (8 - column);
+      break;
+    case CLUE_SYMMETRY_MIRROR:
+      candidates[1] = (row * 9) + (8 - column);
+      candidates[2] = ((8 - row) * 9) + column;
+      candidates[3] = ((8 - row) * 9) + (8 - column);
+      break;
+  }
+
+  size_t orbit_size = 0;
+  for (size_t i = 0; i < 4; i++) {
+    bool seen = false;
+    for (size_t j = 0; j < orbit_size; j++) {
+      seen |= (orbit[j] == candidates[i]);
+    }
+    if (!seen) {
+      orbit[orbit_size++] = candidates[i];
+    }
+  }
+
+  return orbit_size;
+}
+
+// Anneal from the empty initial state until every row and column holds each
+// number once, leaving a complete solution in the puzzle state. Returns false
+// if generation stopped first.
+static bool anneal_complete_grid(struct generator *generator,
+                                 annealing_state *state) {
+  initialize_annealing_state(state);
+
+  while (state->annealing &&
+         !atomic_load_explicit(&generator->stopping, memory_order_relaxed)) {
+    update_annealing_state(state);
+  }
+
+  return !state->annealing;
+}
+
+// Remove clues from \f$puzzle\f$, a copy of a complete solution, one symmetry
+// orbit at a time in random order. An orbit stays removed only if the puzzle
+// still has a unique solution. Returns whether the target clue count was
+// reached.
+static bool remove_clues(struct generator *generator,
+                         annealing_state *state,
+                         carr2_u8 *puzzle) {
+  size_t orbit_cells[81];
+  size_t orbit_count = 0;
+
+  // One representative cell, the lowest numbered, per orbit.
+  for (size_t cell = 0; cell < 81; cell++) {
+    size_t orbit[4];
+    const size_t orbit_size =
+        clue_symmetry_orbit(generator->symmetry, cell, orbit);
+    bool representative = true;
+    for (size_t i = 0; i < orbit_size; i++) {
+      representative &= (orbit[i] >= cell);
+    }
+    if (representative) {
+      orbit_cells[orbit_count++] = cell;
+    }
+  }
+
+  for (size_t i = orbit_count - 1; i > 0; i--) {
+    const size_t j =
+        random_uint32_t(state->random_number_generator_state) % (i + 1);
+    const size_t orbit_cell = orbit_cells[i];
+    orbit_cells[i] = orbit_cells[j];
+    orbit_cells[j] = orbit_cell;
+  }
+
+  uint32_t clues = 81;
+  for (size_t i = 0; i < orbit_count && clues > generator->target_clues; i++) {
+    size_t orbit[4];
+    uint8_t removed_numbers[4];
+    const size_t orbit_size =
+        clue_symmetry_orbit(generator->symmetry, orbit_cells[i], orbit);
+
+    if (clues - orbit_size < generator->target_clues) {
+      continue;
+    }
+
+    for (size_t j = 0; j < orbit_size; j++) {
+      removed_numbers[j] = puzzle->data[orbit[j] / 9][orbit[j] % 9];
+      puzzle->data[orbit[j] / 9][orbit[j] % 9] = 0;
+    }
+
+    if (count_puzzle_solutions(puzzle, 2) == 1) {
+      clues -= orbit_size;
+      continue;
+    }
+
+    for (size_t j = 0; j < orbit_size; j++) {
+      puzzle->data[orbit[j] / 9][orbit[j] % 9] = removed_numbers[j];
+    }
+  }
+
+  return clues == generator->target_clues;
+}
+
+// Puzzles are written in the same format the solver reads them from ARGV.
+static void write_puzzle(struct generator *generator, carr2_u8 *puzzle) {
+  char line[9 * 10];
+  size_t length = 0;
+
+  for (size_t row = 0; row < 9; row++) {
+    for (size_t column = 0; column < 9; column++) {
+      line[length++] = '0' + puzzle->data[row][column];
+    }
+    line[length++] = (row < 8) ? ' ' : '\n';
+  }
+
+  pthread_mutex_lock(&generator->output_lock);
+  fwrite(line, 1, length, stdout);
+  fflush(stdout);
+  pthread_mutex_unlock(&generator->output_lock);
+}
+
+static void *generate_puzzles_on_thread(void *argument) {
+  struct generator *generator = argument;
+
+  carr2_u8 given_puzzle_positions = carr2_u8_with_values(9, 9, 0);
+  carr2_u8 empty_puzzle = carr2_u8_with_values(9, 9, 0);
+  carr2_u8 solution = carr2_u8_with_values(9, 9, 0);
+  carr2_u8 puzzle = carr2_u8_init(9, 9);
+
+  annealing_state state = {
+      .annealing = true,
+      .temperature = 1.0,
+      .initial_puzzle_state = &empty_puzzle,
+      .sudoku_puzzle_state = &solution,
+      .given_puzzle_positions = &given_puzzle_positions,
+      .number_of_state_changes = 0,
+      .sudoku_puzzle_state_cost = 9999,
+      .random_number_generator_state = {0}};
+
+#ifdef ANNEALING_TRACE
+  state.trace = trace_attach();
+#endif
+
+  if (getrandom(state.random_number_generator_state,
+                sizeof(state.random_number_generator_state), 0) < 1) {
+    exit(EXIT_FAILURE);
+  }
+
+  while (anneal_complete_grid(generator, &state)) {
+    for (size_t attempt = 0; attempt < GENERATOR_REMOVAL_ATTEMPTS &&
+                             !atomic_load(&generator->stopping);
+         attempt++) {
+      carr2_u8_copy(&puzzle, solution);
+      if (!remove_clues(generator, &state, &puzzle)) {
+        continue;
+      }
+
+      // Claim a place in the output so that exactly the requested number of
+      // puzzles is written, even while other threads are finishing theirs.
+      const uint64_t claimed =
+          atomic_fetch_add(&generator->puzzles_claimed, 1);
+      if (generator->puzzle_count && claimed >= generator->puzzle_count) {
+        atomic_store(&generator->stopping, true);
+        break;
+      }
+
+      write_puzzle(generator, &puzzle);
+      const uint64_t generated =
+          atomic_fetch_add(&generator->puzzles_generated, 1) + 1;
+
+      // The last puzzle stops the other threads wherever they are, and the
+      // generation rate is taken from the moment it was written.
+      if (generated == generator->puzzle_count) {
+        generator->seconds_to_last_puzzle = seconds_since(&generator->start);
+        atomic_store(&generator->stopping, true);
+      }
+      break;
+    }
+
+    if (atomic_fetch_add(&generator->solutions_annealed, 1) + 1 >=
+            GENERATOR_SOLUTION_LIMIT &&
+        atomic_load(&generator->puzzles_claimed) == 0) {
+      atomic_store(&generator->gave_up, true);
+      atomic_store(&generator->stopping, true);
+    }
+  }
+
+#ifdef ANNEALING_TRACE
+  trace_detach(state.trace);
+#endif
+
+  carr2_u8_drop(&puzzle);
+  carr2_u8_drop(&solution);
+  carr2_u8_drop(&empty_puzzle);
+  carr2_u8_drop(&given_puzzle_positions);
+
+  return NULL;
+}
+
+static void report_generation_rate(struct generator *generator,
+                                   double elapsed) {
+  const uint64_t generated = atomic_load(&generator->puzzles_generated);
+  fprintf(stderr, "%" PRIu64 " puzzles in %.1fs, %.2f puzzles/sec\n",
+          generated, elapsed, elapsed > 0.0 ? generated / elapsed : 0.0);
+}
+
+int generate_puzzles(int argc, char **argv) {
+  if (argc < 1 || argc > 4) {
+    printf("Usage: " PROGRAM_NAME
+           " generate <clues> [count] [none|rotational|mirror] [threads]\n");
+    return EXIT_FAILURE;
+  }
+
+  struct generator generator = {
+      .target_clues = strtoul(argv[0], NULL, 10),
+      .puzzle_count = (argc > 1) ? strtoull(argv[1], NULL, 10) : 0,
+      .symmetry = CLUE_SYMMETRY_ROTATIONAL,
+      .puzzles_claimed = 0,
+      .puzzles_generated = 0,
+      .solutions_annealed = 0,
+      .stopping = false,
+      .gave_up = false,
+      .seconds_to_last_puzzle = 0.0,
+      .output_lock = PTHREAD_MUTEX_INITIALIZER};
+
+  if (argc > 2) {
+    if (strcmp(argv[2], "none") == 0) {
+      generator.symmetry = CLUE_SYMMETRY_NONE;
+    } else if (strcmp(argv[2], "rotational") == 0) {
+      generator.symmetry = CLUE_SYMMETRY_ROTATIONAL;
+    } else if (strcmp(argv[2], "mirror") == 0) {
+      generator.symmetry = CLUE_SYMMETRY_MIRROR;
+    } else {
+      fprintf(stderr, "Unknown symmetry %s.\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  const uint32_t minimum_clues = minimum_target_clues[generator.symmetry];
+  if (generator.target_clues < minimum_clues ||
+      generator.target_clues > 81) {
+    fprintf(stderr,
+            "The clue count must be between %" PRIu32
+            " and 81 with this symmetry.\n",
+            minimum_clues);
+    return EXIT_FAILURE;
+  }
+
+  long thread_count = (argc > 3) ? strtol(argv[3], NULL, 10)
+                                 : sysconf(_SC_NPROCESSORS_ONLN);
+  if (thread_count < 1) {
+    thread_count = 1;
+  }
+
+  pthread_t *threads = calloc(thread_count, sizeof(pthread_t));
+  if (!threads) {
+    return EXIT_FAILURE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &generator.start);
+
+  for (long i = 0; i < thread_count; i++) {
+    if (pthread_create(&threads[i], NULL, generate_puzzles_on_thread,
+                       &generator)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Report the generation rate once a second until the requested number of
+  // puzzles has been written or generation gives up. Without a count this runs
+  // until interrupted.
+  struct timespec part_of_a_second = {.tv_sec = 0, .tv_nsec = 100000000};
+  double last_report = 0.0;
+  while (!atomic_load(&generator.stopping)) {
+    nanosleep(&part_of_a_second, NULL);
+
+    const double elapsed = seconds_since(&generator.start);
+    if (elapsed - last_report >= 1.0 && !atomic_load(&generator.stopping)) {
+      report_generation_rate(&generator, elapsed);
+      last_report = elapsed;
+    }
+  }
+
+  for (long i = 0; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  pthread_mutex_destroy(&generator.output_lock);
+
+  if (atomic_load(&generator.gave_up)) {
+    fprintf(stderr,
+            "No puzzle with %" PRIu32 " clues was found in %d solutions.\n",
+            generator.target_clues, GENERATOR_SOLUTION_LIMIT);
+    return EXIT_FAILURE;
+  }
+
+  report_generation_rate(&generator, generator.seconds_to_last_puzzle);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+int generate_puzzles(int argc, char **argv);
@@ -32,18 +32,63 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "annealing.h"
+#include "batch.h"
 #include "config.h"
+#include "generator.h"
 #include "interface.h"
 #include "puzzle.h"
+#include "schedule.h"
+#include "trace.h"
+
+// A schedule profile produced by sudoku-autotune replaces the default
+// annealing schedule for each puzzle's difficulty bucket.
+static bool load_startup_schedule_profile(schedule_profile *profile) {
+  initialize_schedule_profile(profile);
+
+  const char *profile_path = getenv("SUDOKU_SCHEDULE_PROFILE");
+  if (profile_path && !load_schedule_profile(profile_path, profile)) {
+    fprintf(stderr, "Could not load the schedule profile %s.\n",
+            profile_path);
+    return false;
+  }
+
+  return true;
+}
 
 int main(int argc, char **argv) {
+#ifdef ANNEALING_TRACE
+  trace_start();
+  atexit(trace_stop);
+#endif
+
+  schedule_profile profile;
+
+  if (argc >= 2 && strcmp(argv[1], "generate") == 0) {
+    return generate_puzzles(argc - 2, argv + 2);
+  }
+
+  if (argc >= 2 && strcmp(argv[1], "batch") == 0) {
+    if (!load_startup_schedule_profile(&profile)) {
+      return EXIT_FAILURE;
+    }
+    return solve_puzzle_batch(argc - 2, argv + 2, &profile);
+  }
+
   if (argc != 10) {
     printf("Usage: " PROGRAM_NAME
            " 000000000 000000000 000000000 000000000 000000000 "
-           "000000000 000000000 000000000 000000000\n");
+           "000000000 000000000 000000000 000000000\n"
+           "       " PROGRAM_NAME
+           " generate <clues> [count] [none|rotational|mirror] [threads]\n"
+           "       " PROGRAM_NAME " batch [threads] < puzzles\n");
+    return EXIT_FAILURE;
+  }
+
+  if (!load_startup_schedule_profile(&profile)) {
     return EXIT_FAILURE;
   }
 
@@ -67,9 +112,13 @@ int main(int argc, char **argv) {
 
   carr2_u8_copy(&initial_puzzle_positions, n_by_n);
 
+  const annealing_schedule *schedule =
+      &profile.schedules[difficulty_bucket_of(count_puzzle_clues(&n_by_n))];
+
   annealing_state puzzle_state = {
       .annealing = true,
-      .temperature = 1.0,
+      .temperature = schedule->initial_temperature,
+      .schedule = schedule,
       .initial_puzzle_state = &initial_puzzle_positions,
       .sudoku_puzzle_state = &n_by_n,
       .given_puzzle_positions = &given_puzzle_positions,
@@ -77,6 +126,10 @@ int main(int argc, char **argv) {
       .sudoku_puzzle_state_cost = 9999,
       .random_number_generator_state = {0}};
 
+#ifdef ANNEALING_TRACE
+  puzzle_state.trace = trace_attach();
+#endif
+
   // Seed the random number generator with random data generated
   // by the system.
   if (getrandom(puzzle_state.random_number_generator_state,
@@ -92,10 +145,7 @@ int main(int argc, char **argv) {
   // that each region cannot contain duplicate numbers. This invariant will
   // be maintained when producing new puzzle states by swapping two numbers in a
   // region.
-  fill_puzzle_regions(&puzzle_state);
-
-  puzzle_state.sudoku_puzzle_state_cost =
-      cost(puzzle_state.sudoku_puzzle_state->data);
+  initialize_annealing_state(&puzzle_state);
 
   // Track time to limit UI updates to one update per second.
   clock_t start = clock();
@@ -129,6 +179,10 @@ int main(int argc, char **argv) {
 
   deinitialize_user_interface();
 
+#ifdef ANNEALING_TRACE
+  trace_detach(puzzle_state.trace);
+#endif
+
   carr2_u8_drop(&initial_puzzle_positions);
   carr2_u8_drop(&n_by_n);
   carr2_u8_drop(&given_puzzle_positions);
@@ -2,6 +2,9 @@
 
 #include "puzzle.h"
 #include "rng.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 
 void fill_region(annealing_state *annealing_state, size_t region) {
   clist_u8 list_of_available_numbers = clist_u8_init();
@@ -76,3 +79,279 @@ void fill_puzzle_regions(annealing_state *puzzle_state) {
     fill_region(puzzle_state, region);
   }
 }
+
+// Depth first search over the empty cells of a puzzle, always branching on the
+// cell with the fewest candidates. Row, column and region candidates are kept
+// as bitmasks, bit \f$n\f$ set meaning the number \f$n\f$ is already used.
+static void search_for_solutions(uint8_t *cells,
+                                 uint16_t *used_in_row,
+                                 uint16_t *used_in_column,
+                                 uint16_t *used_in_region,
+                                 uint32_t limit,
+                                 uint32_t *solutions) {
+  size_t best_cell = 81;
+  uint16_t best_candidates = 0;
+  uint32_t best_candidate_count = 10;
+
+  for (size_t cell = 0; cell < 81; cell++) {
+    if (cells[cell]) {
+      continue;
+    }
+
+    const size_t row = cell / 9;
+    const size_t column = cell % 9;
+    const size_t region = ((row / 3) * 3) + (column / 3);
+    const uint16_t candidates =
+        ~(used_in_row[row] | used_in_column[column] | used_in_region[region]) &
+        0x3fe;
+    const uint32_t candidate_count = __builtin_popcount(candidates);
+
+    if (candidate_count < best_candidate_count) {
+      best_cell = cell;
+      best_candidates = candidates;
+      best_candidate_count = candidate_count;
+      if (candidate_count <= 1) {
+        break;
+      }
+    }
+  }
+
+  if (best_cell == 81) {
+    (*solutions)++;
+    return;
+  }
+
+  const size_t row = best_cell / 9;
+  const size_t column = best_cell % 9;
+  const size_t region = ((row / 3) * 3) + (column / 3);
+
+  for (uint8_t number = 1; number <= 9 && *solutions < limit; number++) {
+    const uint16_t bit = 1 << number;
+    if (!(best_candidates & bit)) {
+      continue;
+    }
+
+    cells[best_cell] = number;
+    used_in_row[row] |= bit;
+    used_in_column[column] |= bit;
+    used_in_region[region] |= bit;
+
+    search_for_solutions(cells, used_in_row, used_in_column, used_in_region,
+                         limit, solutions);
+
+    used_in_region[region] &= ~bit;
+    used_in_column[column] &= ~bit;
+    used_in_row[row] &= ~bit;
+    cells[best_cell] = 0;
+  }
+}
+
+// Count the solutions of a puzzle, giving up once \f$limit\f$ solutions have
+// been found. A limit of 2 is enough to tell whether a solution is unique.
+uint32_t count_puzzle_solutions(const carr2_u8 *puzzle, uint32_t limit) {
+  uint8_t cells[81];
+  uint16_t used_in_row[9] = {0};
+  uint16_t used_in_column[9] = {0};
+  uint16_t used_in_region[9] = {0};
+
+  for (size_t row = 0; row < 9; row++) {
+    for (size_t column = 0; column < 9; column++) {
+      const uint8_t number = puzzle->data[row][column];
+      const size_t region = ((row / 3) * 3) + (column / 3);
+      const uint16_t bit = 1 << number;
+
+      cells[(row * 9) + column] = number;
+      if (number == 0) {
+        continue;
+      }
+
+      // A number repeated within a row, column or region can't be solved.
+      if ((used_in_row[row] | used_in_column[column] |
+           used_in_region[region]) &
+          bit) {
+        return 0;
+      }
+
+      used_in_row[row] |= bit;
+      used_in_column[column] |= bit;
+      used_in_region[region] |= bit;
+    }
+  }
+
+  uint32_t solutions = 0;
+  search_for_solutions(cells, used_in_row, used_in_column, used_in_region,
+                       limit, &solutions);
+  return solutions;
+}
+
+// Read a puzzle from a line of text holding its 81 cells row by row, with 0 or
+// . for an empty cell. Whitespace is ignored, so both the solver's argument
+// format and one puzzle per line of 81 characters are accepted.
+bool parse_puzzle(const char *text, carr2_u8 *puzzle) {
+  size_t cell = 0;
+
+  for (; *text; text++) {
+    if (isspace((unsigned char)*text)) {
+      continue;
+    }
+
+    if (cell == 81 || (*text != '.' && !isdigit((unsigned char)*text))) {
+      return false;
+    }
+
+    puzzle->data[cell / 9][cell % 9] = (*text == '.') ? 0 : *text - '0';
+    cell++;
+  }
+
+  return cell == 81;
+}
+
+// Read a list of puzzles, one per line, skipping blank lines and lines
+// starting with #. Annealing a puzzle without a solution never ends, so such
+// puzzles are rejected along with lines that aren't puzzles, reporting the
+// line by \f$name\f$ and line number.
+bool read_puzzle_list(FILE *file,
+                      const char *name,
+                      carr2_u8 **puzzles,
+                      size_t *puzzle_count) {
+  size_t capacity = 0;
+  size_t line_number = 0;
+  char line[256];
+
+  *puzzles = NULL;
+  *puzzle_count = 0;
+
+  while (fgets(line, sizeof(line), file)) {
+    line_number++;
+    if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+
+    if (*puzzle_count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      carr2_u8 *grown_puzzles = realloc(*puzzles, capacity * sizeof(carr2_u8));
+      if (!grown_puzzles) {
+        exit(EXIT_FAILURE);
+      }
+      *puzzles = grown_puzzles;
+    }
+
+    carr2_u8 puzzle = carr2_u8_init(9, 9);
+    if (!parse_puzzle(line, &puzzle) ||
+        count_puzzle_solutions(&puzzle, 1) == 0) {
+      fprintf(stderr, "%s:%zu: not a solvable puzzle\n", name, line_number);
+      carr2_u8_drop(&puzzle);
+      for (size_t i = 0; i < *puzzle_count; i++) {
+        carr2_u8_drop(&(*puzzles)[i]);
+      }
+      free(*puzzles);
+      *puzzles = NULL;
+      *puzzle_count = 0;
+      return false;
+    }
+
+    (*puzzles)[(*puzzle_count)++] = puzzle;
+  }
+
+  return true;
+}
+
+uint32_t count_puzzle_clues(const carr2_u8 *puzzle) {
+  uint32_t clues = 0;
+  for (size_t row = 0; row < 9; row++) {
+    for (size_t column = 0; column < 9; column++) {
+      clues += (puzzle->data[row][column] != 0);
+    }
+  }
+  return clues;
+}
+
+// Fill in every cell that is forced by the cells around it, until no more
+// cells are forced. A cell is forced when only one number can go in it, or
+// when it is the only cell of its row, column or region a number can go in.
+// Returns the number of cells filled.
+uint32_t propagate_constraints(carr2_u8 *puzzle) {
+  uint16_t used_in_row[9] = {0};
+  uint16_t used_in_column[9] = {0};
+  uint16_t used_in_region[9] = {0};
+
+  for (size_t row = 0; row < 9; row++) {
+    for (size_t column = 0; column < 9; column++) {
+      const uint16_t bit = 1 << puzzle->data[row][column];
+      used_in_row[row] |= bit;
+      used_in_column[column] |= bit;
+      used_in_region[((row / 3) * 3) + (column / 3)] |= bit;
+    }
+  }
+
+  uint32_t filled_cells = 0;
+  bool filling = true;
+  while (filling) {
+    filling = false;
+
+    uint16_t candidates[81];
+    for (size_t cell = 0; cell < 81; cell++) {
+      const size_t row = cell / 9;
+      const size_t column = cell % 9;
+      candidates[cell] =
+          puzzle->data[row][column]
+              ? 0
+              : ~(used_in_row[row] | used_in_column[column] |
+                  used_in_region[((row / 3) * 3) + (column / 3)]) &
+                    0x3fe;
+    }
+
+    // Unit \f$u\f$ is row \f$u\f$, column \f$u - 9\f$ or region
+    // \f$u - 18\f$.
+    for (size_t unit = 0; unit < 27; unit++) {
+      uint16_t seen_once = 0;
+      uint16_t seen_twice = 0;
+      size_t cells[9];
+
+      for (size_t i = 0; i < 9; i++) {
+        if (unit < 9) {
+          cells[i] = (unit * 9) + i;
+        } else if (unit < 18) {
+          cells[i] = (i * 9) + (unit - 9);
+        } else {
+          const size_t region = unit - 18;
+          cells[i] = ((((region / 3) * 3) + (i / 3)) * 9) +
+                     ((region % 3) * 3) + (i % 3);
+        }
+        seen_twice |= seen_once & candidates[cells[i]];
+        seen_once |= candidates[cells[i]];
+      }
+
+      const uint16_t hidden_singles = seen_once & ~seen_twice;
+      for (size_t i = 0; i < 9; i++) {
+        if (candidates[cells[i]] & hidden_singles) {
+          candidates[cells[i]] &= hidden_singles;
+        }
+      }
+    }
+
+    for (size_t cell = 0; cell < 81; cell++) {
+      const size_t row = cell / 9;
+      const size_t column = cell % 9;
+      const size_t region = ((row / 3) * 3) + (column / 3);
+      const uint16_t bit = candidates[cell];
+
+      // Another cell filled in this pass may have taken the number already.
+      if (__builtin_popcount(bit) != 1 ||
+          ((used_in_row[row] | used_in_column[column] |
+            used_in_region[region]) &
+           bit)) {
+        continue;
+      }
+
+      puzzle->data[row][column] = __builtin_ctz(bit);
+      used_in_row[row] |= bit;
+      used_in_column[column] |= bit;
+      used_in_region[region] |= bit;
+      filled_cells++;
+      filling = true;
+    }
+  }
+
+  return filled_cells;
+}
@@ -2,7 +2,17 @@
 
 #pragma once
 
+#include <stdio.h>
+
 #include "annealing.h"
 
 void fill_region(annealing_state *puzzle_state, size_t region);
 void fill_puzzle_regions(annealing_state *puzzle_state);
+bool parse_puzzle(const char *text, carr2_u8 *puzzle);
+bool read_puzzle_list(FILE *file,
+                      const char *name,
+                      carr2_u8 **puzzles,
+                      size_t *puzzle_count);
+uint32_t count_puzzle_clues(const carr2_u8 *puzzle);
+uint32_t propagate_constraints(carr2_u8 *puzzle);
+uint32_t count_puzzle_solutions(const carr2_u8 *puzzle, uint32_t limit);
@@ -1,4 +1,5 @@
 #include "rng.h"
+#include <stddef.h>
 
 // xoshiro128++ 1.0 devised by David Blackman and Sebastiano Vigna
 uint32_t random_uint32_t(uint32_t *random_number_generator_state) {
@@ -19,3 +20,18 @@ uint32_t random_uint32_t(uint32_t *random_number_generator_state) {
 
   return random_number;
 }
+
+// Expand a 64 bit seed into a full generator state using SplitMix64, so that
+// runs can be repeated from a single number.
+void seed_random_number_generator(uint32_t *random_number_generator_state,
+                                  uint64_t seed) {
+  for (size_t i = 0; i < 4; i += 2) {
+    seed += 0x9e3779b97f4a7c15;
+    uint64_t mixed_up_bits = seed;
+    mixed_up_bits = (mixed_up_bits ^ (mixed_up_bits >> 30)) * 0xbf58476d1ce4e5b9;
+    mixed_up_bits = (mixed_up_bits ^ (mixed_up_bits >> 27)) * 0x94d049bb133111eb;
+    mixed_up_bits ^= mixed_up_bits >> 31;
+    random_number_generator_state[i] = (uint32_t)mixed_up_bits;
+    random_number_generator_state[i + 1] = (uint32_t)(mixed_up_bits >> 32);
+  }
+}
@@ -3,3 +3,5 @@
 #include <inttypes.h>
 
 uint32_t random_uint32_t(uint32_t *random_number_generator_state);
+void seed_random_number_generator(uint32_t *random_number_generator_state,
+                                  uint64_t seed);
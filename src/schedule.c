@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: ISC
+
+// Schedule profiles are text files with one line per difficulty bucket,
+//
+//  bucket step_max initial_temperature cooling_law cooling_rate
+//
+// where cooling_law is polynomial or exponential, step_max is at least 2, and
+// the temperature and rate are finite and positive. Lines starting with # are
+// comments, and buckets without a line keep the default schedule.
+
+#include "schedule.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+const difficulty_bucket difficulty_buckets[DIFFICULTY_BUCKET_COUNT] = {
+    {.name = "easy", .min_clues = 36, .max_clues = 81},
+    {.name = "medium", .min_clues = 30, .max_clues = 35},
+    {.name = "hard", .min_clues = 25, .max_clues = 29},
+    {.name = "expert", .min_clues = 0, .max_clues = 24}};
+
+size_t difficulty_bucket_of(uint32_t clues) {
+  for (size_t bucket = 0; bucket < DIFFICULTY_BUCKET_COUNT; bucket++) {
+    if (clues >= difficulty_buckets[bucket].min_clues &&
+        clues <= difficulty_buckets[bucket].max_clues) {
+      return bucket;
+    }
+  }
+  return DIFFICULTY_BUCKET_COUNT - 1;
+}
+
+void initialize_schedule_profile(schedule_profile *profile) {
+  for (size_t bucket = 0; bucket < DIFFICULTY_BUCKET_COUNT; bucket++) {
+    profile->schedules[bucket] = default_annealing_schedule;
+  }
+}
+
+bool load_schedule_profile(const char *path, schedule_profile *profile) {
+  initialize_schedule_profile(profile);
+
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  char line[256];
+  bool loaded = true;
+  while (loaded && fgets(line, sizeof(line), file)) {
+    char bucket_name[32];
+    char cooling_law[32];
+    annealing_schedule schedule;
+
+    if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+
+    loaded = false;
+    if (sscanf(line, "%31s %" SCNu64 " %lf %31s %lf", bucket_name,
+               &schedule.step_max, &schedule.initial_temperature, cooling_law,
+               &schedule.cooling_rate) != 5 ||
+        schedule.step_max < 2 || !isfinite(schedule.initial_temperature) ||
+        schedule.initial_temperature <= 0.0 ||
+        !isfinite(schedule.cooling_rate) || schedule.cooling_rate <= 0.0) {
+      break;
+    }
+
+    if (strcmp(cooling_law, "polynomial") == 0) {
+      schedule.cooling_law = COOLING_LAW_POLYNOMIAL;
+    } else if (strcmp(cooling_law, "exponential") == 0) {
+      schedule.cooling_law = COOLING_LAW_EXPONENTIAL;
+    } else {
+      break;
+    }
+
+    for (size_t bucket = 0; bucket < DIFFICULTY_BUCKET_COUNT; bucket++) {
+      if (strcmp(bucket_name, difficulty_buckets[bucket].name) == 0) {
+        profile->schedules[bucket] = schedule;
+        loaded = true;
+      }
+    }
+  }
+
+  fclose(file);
+
+  return loaded;
+}
+
+void write_schedule_profile(FILE *file, const schedule_profile *profile) {
+  fprintf(file,
+          "# bucket step_max initial_temperature cooling_law cooling_rate\n");
+
+  for (size_t bucket = 0; bucket < DIFFICULTY_BUCKET_COUNT; bucket++) {
+    const annealing_schedule *schedule = &profile->schedules[bucket];
+    fprintf(file, "%s %" PRIu64 " %.17g %s %.17g\n",
+            difficulty_buckets[bucket].name, schedule->step_max,
+            schedule->initial_temperature,
+            schedule->cooling_law == COOLING_LAW_EXPONENTIAL ? "exponential"
+                                                             : "polynomial",
+            schedule->cooling_rate);
+  }
+}
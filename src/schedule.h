@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include <stdio.h>
+
+#include "annealing.h"
+
+// Puzzles are grouped into difficulty buckets by their number of clues, and a
+// schedule profile holds a tuned annealing schedule for each bucket.
+#define DIFFICULTY_BUCKET_COUNT 4
+
+struct difficulty_bucket {
+  const char *name;
+  uint32_t min_clues;
+  uint32_t max_clues;
+};
+
+struct schedule_profile {
+  annealing_schedule schedules[DIFFICULTY_BUCKET_COUNT];
+};
+
+typedef struct difficulty_bucket difficulty_bucket;
+typedef struct schedule_profile schedule_profile;
+
+extern const difficulty_bucket difficulty_buckets[DIFFICULTY_BUCKET_COUNT];
+
+size_t difficulty_bucket_of(uint32_t clues);
+void initialize_schedule_profile(schedule_profile *profile);
+bool load_schedule_profile(const char *path, schedule_profile *profile);
+void write_schedule_profile(FILE *file, const schedule_profile *profile);
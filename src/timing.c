@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: ISC
+
+#include "timing.h"
+
+// Wall time elapsed since \f$start\f$, as read from the monotonic clock.
+double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         ((double)(now.tv_nsec - start->tv_nsec) / 1000000000.0);
+}
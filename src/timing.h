@@ -0,0 +1,7 @@
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include <time.h>
+
+double seconds_since(const struct timespec *start);
@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: ISC
+
+// Sampled annealing trajectories are written to the file named by the
+// SUDOKU_TRACE_FILE environment variable. Every SUDOKU_TRACE_INTERVAL-th step
+// (rounded up to a power of two), every reheat and every solution is recorded.
+// Chains only ever append to their own ring buffer; a background thread drains
+// the buffers to the file, so the annealing loop never waits on I/O.
+
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_DEFAULT_SAMPLE_INTERVAL 1024
+
+// Sample intervals are written to the trace file header as 32 bits.
+#define TRACE_MAX_SAMPLE_INTERVAL ((uint64_t)1 << 31)
+
+static FILE *trace_file;
+static pthread_t trace_writer;
+static pthread_mutex_t trace_buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_buffer *trace_buffers;
+static uint32_t trace_sample_interval;
+static uint64_t trace_dropped_records;
+static uint32_t trace_chains;
+static atomic_bool trace_stopping;
+
+// Write out the records a chain has published since the last drain. Records
+// wrapping around the end of the ring are written in two parts.
+static void drain_trace_buffer(trace_buffer *buffer) {
+  const uint64_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+  uint64_t tail = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+
+  while (tail != head) {
+    const uint64_t offset = tail & (TRACE_BUFFER_CAPACITY - 1);
+    uint64_t count = head - tail;
+    if (offset + count > TRACE_BUFFER_CAPACITY) {
+      count = TRACE_BUFFER_CAPACITY - offset;
+    }
+
+    fwrite(&buffer->records[offset], sizeof(trace_record), count, trace_file);
+    tail += count;
+  }
+
+  atomic_store_explicit(&buffer->tail, tail, memory_order_release);
+}
+
+// Drain every buffer, freeing the ones whose chains have detached. New
+// buffers are only ever added to the front of the list and only the writer
+// removes them, so the list can be walked from a snapshot of its head while
+// chains attach, and only unlinking needs the lock.
+static void drain_trace_buffers(void) {
+  pthread_mutex_lock(&trace_buffers_lock);
+  trace_buffer *first_buffer = trace_buffers;
+  pthread_mutex_unlock(&trace_buffers_lock);
+
+  bool any_retired = false;
+  for (trace_buffer *buffer = first_buffer; buffer; buffer = buffer->next) {
+    const bool detached = atomic_load(&buffer->detached);
+
+    drain_trace_buffer(buffer);
+
+    buffer->retired = detached;
+    any_retired |= detached;
+  }
+
+  if (!any_retired) {
+    return;
+  }
+
+  pthread_mutex_lock(&trace_buffers_lock);
+  trace_buffer **link = &trace_buffers;
+  while (*link) {
+    trace_buffer *buffer = *link;
+    if (buffer->retired) {
+      trace_dropped_records += atomic_load(&buffer->dropped);
+      *link = buffer->next;
+      free(buffer);
+    } else {
+      link = &buffer->next;
+    }
+  }
+  pthread_mutex_unlock(&trace_buffers_lock);
+}
+
+static void *write_trace_buffers(void *argument) {
+  (void)argument;
+
+  struct timespec part_of_a_second = {.tv_sec = 0, .tv_nsec = 10000000};
+  while (!atomic_load(&trace_stopping)) {
+    drain_trace_buffers();
+    fflush(trace_file);
+    nanosleep(&part_of_a_second, NULL);
+  }
+
+  return NULL;
+}
+
+void trace_start(void) {
+  const char *path = getenv("SUDOKU_TRACE_FILE");
+  if (!path || trace_file) {
+    return;
+  }
+
+  trace_file = fopen(path, "wb");
+  if (!trace_file) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  const char *interval = getenv("SUDOKU_TRACE_INTERVAL");
+  uint64_t requested_interval =
+      interval ? strtoull(interval, NULL, 10) : TRACE_DEFAULT_SAMPLE_INTERVAL;
+  if (requested_interval > TRACE_MAX_SAMPLE_INTERVAL) {
+    requested_interval = TRACE_MAX_SAMPLE_INTERVAL;
+  }
+  trace_sample_interval = 1;
+  while (trace_sample_interval < requested_interval) {
+    trace_sample_interval <<= 1;
+  }
+
+  trace_file_header header = {.record_size = sizeof(trace_record),
+                              .sample_interval = trace_sample_interval};
+  memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+  fwrite(&header, sizeof(header), 1, trace_file);
+
+  if (pthread_create(&trace_writer, NULL, write_trace_buffers, NULL)) {
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Chains are expected to have finished annealing before tracing stops.
+void trace_stop(void) {
+  if (!trace_file) {
+    return;
+  }
+
+  atomic_store(&trace_stopping, true);
+  pthread_join(trace_writer, NULL);
+
+  pthread_mutex_lock(&trace_buffers_lock);
+  for (trace_buffer *buffer = trace_buffers; buffer; buffer = buffer->next) {
+    atomic_store(&buffer->detached, true);
+  }
+  pthread_mutex_unlock(&trace_buffers_lock);
+  drain_trace_buffers();
+
+  if (trace_dropped_records) {
+    fprintf(stderr, "Trace buffers overflowed, %" PRIu64 " records dropped.\n",
+            trace_dropped_records);
+  }
+
+  fclose(trace_file);
+  trace_file = NULL;
+}
+
+// Returns NULL when tracing is not active, which the annealing loop treats as
+// nothing to record.
+trace_buffer *trace_attach(void) {
+  if (!trace_file) {
+    return NULL;
+  }
+
+  trace_buffer *buffer = calloc(1, sizeof(trace_buffer));
+  if (!buffer) {
+    exit(EXIT_FAILURE);
+  }
+  buffer->sample_mask = trace_sample_interval - 1;
+
+  pthread_mutex_lock(&trace_buffers_lock);
+  buffer->chain = trace_chains++;
+  buffer->next = trace_buffers;
+  trace_buffers = buffer;
+  pthread_mutex_unlock(&trace_buffers_lock);
+
+  return buffer;
+}
+
+// The buffer is freed by the writer once its last records are written.
+void trace_detach(trace_buffer *buffer) {
+  if (buffer) {
+    atomic_store(&buffer->detached, true);
+  }
+}
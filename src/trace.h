@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "config.h"
+
+// Trace files start with a header followed by fixed size records in the byte
+// order of the machine that wrote them.
+#define TRACE_FILE_MAGIC "SATRACE1"
+
+struct trace_file_header {
+  char magic[8];
+  uint32_t record_size;
+  uint32_t sample_interval;
+};
+
+// The step is \f$k\f$ of the annealing schedule, restarting from 0 on every
+// reheat. A chain's runs, each started by initialize_annealing_state, are
+// numbered from 1, and reheats are counted from the start of the run.
+#define TRACE_RECORD_ACCEPTED 0x1
+#define TRACE_RECORD_REHEATED 0x2
+#define TRACE_RECORD_RUN_STARTED 0x4
+
+struct trace_record {
+  uint64_t step;
+  float temperature;
+  uint32_t chain;
+  uint32_t run;
+  uint16_t reheats;
+  uint8_t cost;
+  uint8_t flags;
+};
+
+typedef struct trace_file_header trace_file_header;
+typedef struct trace_record trace_record;
+
+#ifdef ANNEALING_TRACE
+
+// Must be a power of two.
+#define TRACE_BUFFER_CAPACITY 4096
+
+// Each annealing chain owns a ring buffer that only it writes records to, and
+// only the background writer reads records from. A full buffer drops records
+// rather than stall the chain.
+struct trace_buffer {
+  trace_record records[TRACE_BUFFER_CAPACITY];
+  _Atomic uint64_t head;
+  _Atomic uint64_t tail;
+  _Atomic uint64_t dropped;
+  atomic_bool detached;
+  // Set by the writer once the last records of a detached chain are written.
+  bool retired;
+  uint64_t sample_mask;
+  uint32_t chain;
+  uint32_t run;
+  uint16_t reheats;
+  bool run_started;
+  struct trace_buffer *next;
+};
+
+typedef struct trace_buffer trace_buffer;
+
+void trace_start(void);
+void trace_stop(void);
+trace_buffer *trace_attach(void);
+void trace_detach(trace_buffer *buffer);
+
+static inline void trace_annealing_run(trace_buffer *buffer) {
+  if (!buffer) {
+    return;
+  }
+
+  buffer->run++;
+  buffer->reheats = 0;
+  buffer->run_started = true;
+}
+
+// Called on every annealing step, so all but the sampled steps, the first step
+// of a run, reheats and solutions return after a single branch.
+static inline void trace_annealing_step(trace_buffer *buffer,
+                                        uint64_t step,
+                                        double temperature,
+                                        uint32_t cost,
+                                        bool accepted,
+                                        bool reheated) {
+  if (!buffer) {
+    return;
+  }
+
+  buffer->reheats += reheated;
+
+  if ((step & buffer->sample_mask) && !reheated && !buffer->run_started &&
+      cost != 0) {
+    return;
+  }
+
+  const uint64_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+  const uint64_t tail = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+  if (head - tail >= TRACE_BUFFER_CAPACITY) {
+    atomic_fetch_add_explicit(&buffer->dropped, 1, memory_order_relaxed);
+    return;
+  }
+
+  buffer->records[head & (TRACE_BUFFER_CAPACITY - 1)] = (trace_record){
+      .step = step,
+      .temperature = temperature,
+      .chain = buffer->chain,
+      .run = buffer->run,
+      .reheats = buffer->reheats,
+      .cost = cost,
+      .flags = (accepted ? TRACE_RECORD_ACCEPTED : 0) |
+               (reheated ? TRACE_RECORD_REHEATED : 0) |
+               (buffer->run_started ? TRACE_RECORD_RUN_STARTED : 0)};
+  buffer->run_started = false;
+
+  atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+}
+
+#define TRACE_ANNEALING_RUN(state) trace_annealing_run((state)->trace)
+
+#define TRACE_ANNEALING_STEP(state, accepted, reheated)               \
+  trace_annealing_step((state)->trace, (state)->number_of_state_changes, \
+                       (state)->temperature,                            \
+                       (state)->sudoku_puzzle_state_cost, (accepted),   \
+                       (reheated))
+
+#else
+
+#define TRACE_ANNEALING_RUN(state) ((void)0)
+#define TRACE_ANNEALING_STEP(state, accepted, reheated) ((void)0)
+
+#endif
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: ISC
+
+// Converts a binary annealing trace into CSV, one row per recorded step.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    printf("Usage: sudoku-trace-reader <trace file>\n");
+    return EXIT_FAILURE;
+  }
+
+  FILE *trace_file = fopen(argv[1], "rb");
+  if (!trace_file) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  trace_file_header header;
+  if (fread(&header, sizeof(header), 1, trace_file) != 1 ||
+      memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.record_size != sizeof(trace_record)) {
+    fprintf(stderr, "%s is not a trace file this reader understands.\n",
+            argv[1]);
+    fclose(trace_file);
+    return EXIT_FAILURE;
+  }
+
+  printf("chain,run,step,temperature,cost,accepted,reheats,reheated,"
+         "run_started\n");
+
+  trace_record records[1024];
+  size_t count;
+  while ((count = fread(records, sizeof(trace_record), 1024, trace_file)) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      printf("%" PRIu32 ",%" PRIu32 ",%" PRIu64 ",%.6f,%" PRIu8 ",%d,%" PRIu16
+             ",%d,%d\n",
+             records[i].chain, records[i].run, records[i].step,
+             records[i].temperature, records[i].cost,
+             (records[i].flags & TRACE_RECORD_ACCEPTED) != 0,
+             records[i].reheats,
+             (records[i].flags & TRACE_RECORD_REHEATED) != 0,
+             (records[i].flags & TRACE_RECORD_RUN_STARTED) != 0);
+    }
+  }
+
+  fclose(trace_file);
+
+  return EXIT_SUCCESS;
+}